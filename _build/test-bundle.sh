@@ -0,0 +1,7 @@
+#!/usr/bin/runscript /home/sfkleach/projects/runscript/_build/test-runscript
+#! --shared
+#! BUNDLE=shared
+#!@ test-bundle-one
+#! --one
+#!@ test-bundle-two
+#! --two ${UNDEFINED_IN_ONE}
@@ -0,0 +1,5 @@
+#!/usr/bin/runscript /home/sfkleach/projects/runscript/_build/test-runscript
+#! --option1
+#!> </dev/null
+#!> 1>${}.out
+#!> 2>&1
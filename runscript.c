@@ -1,4 +1,5 @@
 #define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE  // For O_DIRECT and F_SETPIPE_SZ where the platform has them.
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,6 +8,8 @@
 #include <ctype.h>
 #include <stdbool.h>
 #include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
 
 // External environment variable (for execve).
 extern char **environ;
@@ -17,6 +20,8 @@ extern char **environ;
 #define EXIT_MALFORMED_SHEBANG 3
 #define EXIT_INVALID_HEADER 4
 #define EXIT_EXEC_FAILURE 5
+#define EXIT_NO_SECTION 6
+#define EXIT_REDIRECT_FAILURE 7
 
 // Dynamic array for strings.
 typedef struct {
@@ -39,6 +44,34 @@ typedef struct {
     size_t capacity;
 } BindingArray;
 
+// Kinds of descriptor directive.
+typedef enum {
+    REDIRECT_INPUT,        // N<PATH
+    REDIRECT_TRUNCATE,     // N>PATH
+    REDIRECT_APPEND,       // N>>PATH
+    REDIRECT_READ_WRITE,   // N<>PATH
+    REDIRECT_DUP,          // N>&M
+    REDIRECT_CLOSE,        // N>&-
+    REDIRECT_NONE          // N, with modifiers only
+} RedirectKind;
+
+// Descriptor directive, applied just before exec.
+typedef struct {
+    int fd;
+    RedirectKind kind;
+    char *path;            // For kinds that open a file.
+    int source_fd;         // For REDIRECT_DUP.
+    bool direct;           // Open with O_DIRECT.
+    long pipe_size;        // F_SETPIPE_SZ, or 0 to leave unchanged.
+} Redirection;
+
+// Dynamic array for descriptor directives.
+typedef struct {
+    Redirection *items;
+    size_t count;
+    size_t capacity;
+} RedirectionArray;
+
 // Metacharacters flags.
 typedef struct {
     bool literal;          // !
@@ -46,11 +79,14 @@ typedef struct {
     bool no_subst;         // $
     bool no_binding;       // =
     bool comment;          // #
+    bool section;          // @
+    bool redirect;         // >
 } Metachars;
 
 // Global state.
 static StringArray arguments;
 static BindingArray bindings;
+static RedirectionArray redirections;
 static bool script_name_used = false;
 static char *script_path = NULL;
 static char *executable = NULL;
@@ -103,6 +139,28 @@ static void append_binding_array(BindingArray *arr, Binding binding) {
     arr->items[arr->count++] = binding;
 }
 
+static void init_redirection_array(RedirectionArray *arr, size_t initial_capacity) {
+    arr->items = malloc(initial_capacity * sizeof(Redirection));
+    if (!arr->items) {
+        perror("malloc");
+        exit(EXIT_GENERAL_ERROR);
+    }
+    arr->count = 0;
+    arr->capacity = initial_capacity;
+}
+
+static void append_redirection_array(RedirectionArray *arr, Redirection redirection) {
+    if (arr->count >= arr->capacity) {
+        arr->capacity *= 2;
+        arr->items = realloc(arr->items, arr->capacity * sizeof(Redirection));
+        if (!arr->items) {
+            perror("realloc");
+            exit(EXIT_GENERAL_ERROR);
+        }
+    }
+    arr->items[arr->count++] = redirection;
+}
+
 // ============================================================================
 // String Utilities
 // ============================================================================
@@ -269,6 +327,207 @@ static char *process_substitution(const char *input) {
     return output;
 }
 
+// ============================================================================
+// Descriptor Redirection
+// ============================================================================
+
+static void invalid_redirection(const char *body, const char *reason) {
+    fprintf(stderr, "runscript: invalid descriptor directive: %s\n", body);
+    fprintf(stderr, "  %s\n", reason);
+    fprintf(stderr, "  Hint: Directives have the form [direct] [pipesize=BYTES] [N]OP TARGET,\n");
+    fprintf(stderr, "        where OP is one of: < > >> <> >&\n");
+    exit(EXIT_INVALID_HEADER);
+}
+
+// Parses a non-negative decimal number at *p, advancing *p past it.
+static bool parse_number(const char **p, long *result) {
+    if (!isdigit((unsigned char)**p)) {
+        return false;
+    }
+    char *end;
+    errno = 0;
+    long value = strtol(*p, &end, 10);
+    if (errno != 0 || value > INT_MAX) {
+        return false;
+    }
+    *p = end;
+    *result = value;
+    return true;
+}
+
+static void skip_whitespace(const char **p) {
+    while (**p && isspace((unsigned char)**p)) {
+        (*p)++;
+    }
+}
+
+static void parse_redirection(const char *body) {
+    Redirection r = {
+        .fd = -1,
+        .kind = REDIRECT_NONE,
+        .path = NULL,
+        .source_fd = -1,
+        .direct = false,
+        .pipe_size = 0
+    };
+    const char *p = body;
+    
+    // Leading modifier words.
+    for (;;) {
+        if (strncmp(p, "direct", 6) == 0 && isspace((unsigned char)p[6])) {
+#ifdef O_DIRECT
+            r.direct = true;
+            p += 6;
+#else
+            invalid_redirection(body, "O_DIRECT is not supported on this platform.");
+#endif
+        } else if (strncmp(p, "pipesize=", 9) == 0) {
+#ifdef F_SETPIPE_SZ
+            p += 9;
+            if (!parse_number(&p, &r.pipe_size) || r.pipe_size == 0 || !isspace((unsigned char)*p)) {
+                invalid_redirection(body, "The pipe size must be a positive number of bytes.");
+            }
+#else
+            invalid_redirection(body, "Setting the pipe size is not supported on this platform.");
+#endif
+        } else {
+            break;
+        }
+        skip_whitespace(&p);
+    }
+    
+    // Optional descriptor number.
+    long fd = -1;
+    if (isdigit((unsigned char)*p) && !parse_number(&p, &fd)) {
+        invalid_redirection(body, "The descriptor number is out of range.");
+    }
+    
+    // Operator. Input operators default to descriptor 0, as in the shell.
+    bool input_side = *p == '<';
+    if (*p == '\0') {
+        r.kind = REDIRECT_NONE;
+    } else if (strncmp(p, "<>", 2) == 0) {
+        r.kind = REDIRECT_READ_WRITE;
+        p += 2;
+    } else if (strncmp(p, ">>", 2) == 0) {
+        r.kind = REDIRECT_APPEND;
+        p += 2;
+    } else if (strncmp(p, ">&", 2) == 0 || strncmp(p, "<&", 2) == 0) {
+        r.kind = REDIRECT_DUP;
+        p += 2;
+    } else if (*p == '<') {
+        r.kind = REDIRECT_INPUT;
+        p++;
+    } else if (*p == '>') {
+        r.kind = REDIRECT_TRUNCATE;
+        p++;
+    } else {
+        invalid_redirection(body, "Expected a redirection operator.");
+    }
+    
+    if (fd < 0) {
+        if (r.kind == REDIRECT_NONE) {
+            invalid_redirection(body, "A descriptor number is required when there is no operator.");
+        }
+        fd = input_side ? 0 : 1;
+    }
+    r.fd = (int)fd;
+    
+    // Target.
+    skip_whitespace(&p);
+    if (r.kind == REDIRECT_DUP) {
+        long source_fd;
+        if (strcmp(p, "-") == 0) {
+            r.kind = REDIRECT_CLOSE;
+        } else if (parse_number(&p, &source_fd) && *p == '\0') {
+            r.source_fd = (int)source_fd;
+        } else {
+            invalid_redirection(body, "Expected a descriptor number or '-' after '>&'.");
+        }
+    } else if (r.kind != REDIRECT_NONE) {
+        if (*p == '\0') {
+            invalid_redirection(body, "Expected a file path after the operator.");
+        }
+        r.path = strdup_safe(p);
+    } else if (r.pipe_size == 0) {
+        invalid_redirection(body, "A directive without an operator must set pipesize.");
+    }
+    
+    if (r.direct && r.path == NULL) {
+        invalid_redirection(body, "The direct modifier only applies to directives that open a file.");
+    }
+    if (r.pipe_size != 0 && r.kind == REDIRECT_CLOSE) {
+        invalid_redirection(body, "Cannot set the pipe size of a closed descriptor.");
+    }
+    
+    append_redirection_array(&redirections, r);
+}
+
+static void redirect_failure(const Redirection *r, const char *action) {
+    int saved_errno = errno;
+    fprintf(stderr, "runscript: cannot %s descriptor %d", action, r->fd);
+    if (r->path) {
+        fprintf(stderr, " (%s)", r->path);
+    }
+    fprintf(stderr, ": %s\n", strerror(saved_errno));
+    if (r->pipe_size != 0 && strcmp(action, "set pipe size of") == 0) {
+        fprintf(stderr, "  Hint: pipesize only applies to descriptors that are pipes.\n");
+    } else {
+        fprintf(stderr, "  Hint: Check the descriptor directives in the script header.\n");
+    }
+    exit(EXIT_REDIRECT_FAILURE);
+}
+
+// Applies the descriptor directives in order, as the shell would.
+static void apply_redirections(void) {
+    for (size_t i = 0; i < redirections.count; i++) {
+        const Redirection *r = &redirections.items[i];
+        int flags = 0;
+        switch (r->kind) {
+            case REDIRECT_INPUT:      flags = O_RDONLY; break;
+            case REDIRECT_TRUNCATE:   flags = O_WRONLY | O_CREAT | O_TRUNC; break;
+            case REDIRECT_APPEND:     flags = O_WRONLY | O_CREAT | O_APPEND; break;
+            case REDIRECT_READ_WRITE: flags = O_RDWR | O_CREAT; break;
+            case REDIRECT_DUP:
+                // dup2 onto itself succeeds without checking, so check explicitly.
+                if (r->source_fd == r->fd ? fcntl(r->fd, F_GETFD) < 0 : dup2(r->source_fd, r->fd) < 0) {
+                    redirect_failure(r, "duplicate onto");
+                }
+                break;
+            case REDIRECT_CLOSE:
+                // Closing a descriptor that is not open is harmless, as in the shell.
+                close(r->fd);
+                break;
+            case REDIRECT_NONE:
+                break;
+        }
+        
+        if (r->path) {
+#ifdef O_DIRECT
+            if (r->direct) {
+                flags |= O_DIRECT;
+            }
+#endif
+            int opened = open(r->path, flags, 0666);
+            if (opened < 0) {
+                redirect_failure(r, "open file for");
+            }
+            if (opened != r->fd) {
+                if (dup2(opened, r->fd) < 0) {
+                    redirect_failure(r, "open file for");
+                }
+                close(opened);
+            }
+        }
+        
+#ifdef F_SETPIPE_SZ
+        if (r->pipe_size != 0 && fcntl(r->fd, F_SETPIPE_SZ, (int)r->pipe_size) < 0) {
+            redirect_failure(r, "set pipe size of");
+        }
+#endif
+    }
+}
+
 // ============================================================================
 // Header Line Parsing
 // ============================================================================
@@ -287,9 +546,11 @@ static void parse_metachars(const char *line, Metachars *meta, size_t *body_star
             case '$': meta->no_subst = true; break;
             case '=': meta->no_binding = true; break;
             case '#': meta->comment = true; break;
+            case '@': meta->section = true; break;
+            case '>': meta->redirect = true; break;
             default:
                 fprintf(stderr, "runscript: invalid metacharacter '%c' in header line\n", line[i]);
-                fprintf(stderr, "  Hint: Valid metacharacters are: ! \\ $ = #\n");
+                fprintf(stderr, "  Hint: Valid metacharacters are: ! \\ $ = # @ >\n");
                 exit(EXIT_INVALID_HEADER);
         }
         i++;
@@ -321,6 +582,30 @@ static bool is_valid_var_name(const char *name) {
     return true;
 }
 
+// Returns the name of the section introduced by a `#!@ <name>` line, or NULL
+// if the line is not a section line. The caller must free the result.
+static char *parse_section_line(const char *line) {
+    Metachars meta;
+    size_t body_start;
+    parse_metachars(line, &meta, &body_start);
+    
+    // A comment is still a comment even if it mentions `@`.
+    if (!meta.section || meta.comment) {
+        return NULL;
+    }
+    
+    // Section names are matched against the basename of the invocation path,
+    // so anything empty or containing '/' could never be selected.
+    char *name = strdup_safe(line + body_start);
+    strip_whitespace(name);
+    if (name[0] == '\0' || strchr(name, '/')) {
+        fprintf(stderr, "runscript: invalid section name in header line: %s\n", line);
+        fprintf(stderr, "  Hint: Section names must be non-empty and must not contain '/'.\n");
+        exit(EXIT_INVALID_HEADER);
+    }
+    return name;
+}
+
 static void process_header_line(const char *line) {
     Metachars meta;
     size_t body_start;
@@ -363,6 +648,10 @@ static void process_header_line(const char *line) {
         body = processed;
     }
     
+    // A ${} in a descriptor directive names a file, not an argument, so it must
+    // not stop the script filename being appended.
+    bool script_name_used_before = script_name_used;
+    
     // Apply substitution processing unless disabled.
     if (!meta.no_subst) {
         processed = process_substitution(body);
@@ -370,6 +659,19 @@ static void process_header_line(const char *line) {
         body = processed;
     }
     
+    // Descriptor directives are collected and applied just before exec.
+    if (meta.redirect) {
+        if (!has_whitespace || body[0] == '\0') {
+            fprintf(stderr, "runscript: empty descriptor directive in header line: %s\n", line);
+            fprintf(stderr, "  Hint: Write a redirection after '#!>', e.g. '#!> 1>>${}.log'.\n");
+            exit(EXIT_INVALID_HEADER);
+        }
+        script_name_used = script_name_used_before;
+        parse_redirection(body);
+        free(body);
+        return;
+    }
+    
     // Short form without literal or comment becomes empty string argument.
     if (!has_whitespace) {
         append_string_array(&arguments, strdup_safe(""));
@@ -458,9 +760,15 @@ int main(int argc, char **argv) {
     // Initialize arrays.
     init_string_array(&arguments, 16);
     init_binding_array(&bindings, 64);
+    init_redirection_array(&redirections, 8);
     
     // Get script path and resolve to canonical path.
     const char *script_arg = argv[1];
+    
+    // The section of a bundle is chosen by the name the script was invoked
+    // under, i.e. the symlink, so take it before the path is resolved.
+    const char *invoked_name = strrchr(script_arg, '/');
+    invoked_name = invoked_name ? invoked_name + 1 : script_arg;
     char resolved_path[PATH_MAX];
     if (!realpath(script_arg, resolved_path)) {
         perror("runscript: realpath");
@@ -536,7 +844,11 @@ int main(int argc, char **argv) {
     free(line);
     line = NULL;
     
-    // Parse header lines.
+    // Parse header lines. Lines before the first `#!@` section line are shared;
+    // after that, only the section named after the invocation is processed.
+    bool is_bundle = false;
+    bool in_selected_section = false;
+    bool section_found = false;
     while ((line_len = getline(&line, &line_cap, fp)) >= 0) {
         // Remove trailing newline.
         if (line_len > 0 && line[line_len - 1] == '\n') {
@@ -549,12 +861,34 @@ int main(int argc, char **argv) {
             break;  // End of header block.
         }
         
-        process_header_line(line);
+        char *section = parse_section_line(line);
+        if (section) {
+            if (in_selected_section) {
+                // The rest of the bundle belongs to other entry points.
+                free(section);
+                break;
+            }
+            is_bundle = true;
+            in_selected_section = strcmp(section, invoked_name) == 0;
+            section_found = section_found || in_selected_section;
+            free(section);
+            continue;
+        }
+        
+        if (!is_bundle || in_selected_section) {
+            process_header_line(line);
+        }
     }
     
     free(line);
     fclose(fp);
     
+    if (is_bundle && !section_found) {
+        fprintf(stderr, "runscript: no section named '%s' in bundle %s\n", invoked_name, script_path);
+        fprintf(stderr, "  Hint: Invoke the bundle through a symlink whose name matches a '#!@ <name>' line.\n");
+        return EXIT_NO_SECTION;
+    }
+    
     // Add any command-line arguments passed to runscript (after the script name).
     for (int i = 2; i < argc; i++) {
         append_string_array(&arguments, strdup_safe(argv[i]));
@@ -582,6 +916,10 @@ int main(int argc, char **argv) {
     // Bindings have already been applied to the environment during parsing.
     // The environment is now ready for execution.
     
+    // Set up descriptors last so that nothing is opened or truncated if the
+    // header turns out to be invalid.
+    apply_redirections();
+    
     // Execute.
     // If executable contains '/', use it as a path; otherwise search PATH.
     if (strchr(executable, '/')) {
@@ -3,117 +3,239 @@
  *
  * A test utility that outputs JSON containing the environment variables
  * and command-line arguments it receives. Used for testing runscript behavior.
+ *
+ * Because every argument is part of what is being probed, the output mode is
+ * selected through the environment rather than through options:
+ *
+ *   TEST_RUNSCRIPT_FORMAT=json      The default. Escaped JSON, as above.
+ *   TEST_RUNSCRIPT_FORMAT=nul       A binary form: the decimal count of env
+ *                                   entries, then each entry, then the decimal
+ *                                   count of argv entries, then each entry.
+ *                                   Every item is terminated by a NUL byte.
+ *   TEST_RUNSCRIPT_START_NS=<ns>    Latency probe. Print the nanoseconds that
+ *                                   have elapsed since <ns>, a CLOCK_REALTIME
+ *                                   timestamp such as `date +%s%N`, and exit
+ *                                   without reporting env or argv.
+ *
+ * Output is written through a fixed buffer with write(2) and nothing is
+ * allocated, so that the cost of the probe stays small next to the cost of
+ * the launch being measured, even with very large environments.
  */
 
 #define _POSIX_C_SOURCE 200809L
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 // External environment variables provided by the system.
 extern char **environ;
 
-/*
- * Escape a string for JSON output.
- * Handles: " \ / \b \f \n \r \t and control characters.
- * Returns a newly allocated string that must be freed by the caller.
- */
-static char *json_escape(const char *str) {
-    if (str == NULL) {
-        return strdup("null");
+// ============================================================================
+// Buffered Output
+// ============================================================================
+
+static char out_buf[64 * 1024];
+static size_t out_len = 0;
+
+static void flush_output(void) {
+    size_t done = 0;
+    while (done < out_len) {
+        ssize_t n = write(STDOUT_FILENO, out_buf + done, out_len - done);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("test-runscript: write");
+            exit(1);
+        }
+        done += (size_t)n;
     }
+    out_len = 0;
+}
 
-    // Calculate required size (worst case: every char needs escaping).
-    size_t len = strlen(str);
-    size_t max_size = len * 6 + 1;  // \uXXXX is worst case (6 chars per char).
-    char *escaped = malloc(max_size);
-    if (escaped == NULL) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(1);
+static void emit_bytes(const char *bytes, size_t len) {
+    while (len > 0) {
+        if (out_len == sizeof(out_buf)) {
+            flush_output();
+        }
+        size_t chunk = sizeof(out_buf) - out_len;
+        if (chunk > len) {
+            chunk = len;
+        }
+        memcpy(out_buf + out_len, bytes, chunk);
+        out_len += chunk;
+        bytes += chunk;
+        len -= chunk;
     }
+}
 
-    char *out = escaped;
-    for (const char *in = str; *in; in++) {
-        switch (*in) {
-            case '"':
-                *out++ = '\\';
-                *out++ = '"';
-                break;
-            case '\\':
-                *out++ = '\\';
-                *out++ = '\\';
-                break;
-            case '\b':
-                *out++ = '\\';
-                *out++ = 'b';
-                break;
-            case '\f':
-                *out++ = '\\';
-                *out++ = 'f';
-                break;
-            case '\n':
-                *out++ = '\\';
-                *out++ = 'n';
-                break;
-            case '\r':
-                *out++ = '\\';
-                *out++ = 'r';
-                break;
-            case '\t':
-                *out++ = '\\';
-                *out++ = 't';
-                break;
-            default:
-                if ((unsigned char)*in < 0x20) {
-                    // Control character: use \uXXXX format.
-                    out += sprintf(out, "\\u%04x", (unsigned char)*in);
-                } else {
-                    *out++ = *in;
-                }
+static void emit_string(const char *str) {
+    emit_bytes(str, strlen(str));
+}
+
+static void emit_char(char c) {
+    if (out_len == sizeof(out_buf)) {
+        flush_output();
+    }
+    out_buf[out_len++] = c;
+}
+
+static void emit_unsigned(unsigned long long value) {
+    char digits[24];
+    size_t i = sizeof(digits);
+    do {
+        digits[--i] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    emit_bytes(digits + i, sizeof(digits) - i);
+}
+
+// ============================================================================
+// JSON Output
+// ============================================================================
+
+/*
+ * Write a string as escaped JSON, without the surrounding quotes.
+ * Handles: " \ \b \f \n \r \t and control characters. Runs of characters
+ * that need no escaping are copied in a single chunk.
+ */
+static void emit_json_escaped(const char *str) {
+    static const char hex[] = "0123456789abcdef";
+    const char *run = str;
+    const char *in = str;
+    for (; *in; in++) {
+        unsigned char c = (unsigned char)*in;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        emit_bytes(run, (size_t)(in - run));
+        run = in + 1;
+        switch (c) {
+            case '"':  emit_string("\\\""); break;
+            case '\\': emit_string("\\\\"); break;
+            case '\b': emit_string("\\b"); break;
+            case '\f': emit_string("\\f"); break;
+            case '\n': emit_string("\\n"); break;
+            case '\r': emit_string("\\r"); break;
+            case '\t': emit_string("\\t"); break;
+            default: {
+                // Control character: use \uXXXX format.
+                char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+                emit_bytes(escape, sizeof(escape));
                 break;
+            }
         }
     }
-    *out = '\0';
-    return escaped;
+    emit_bytes(run, (size_t)(in - run));
 }
 
 /*
  * Print a JSON string array.
  */
 static void print_string_array(const char *label, char **strings, int count) {
-    printf("    \"%s\": [\n", label);
+    emit_string("    \"");
+    emit_string(label);
+    emit_string("\": [\n");
     for (int i = 0; i < count; i++) {
-        char *escaped = json_escape(strings[i]);
-        printf("        \"%s\"", escaped);
+        emit_string("        \"");
+        emit_json_escaped(strings[i]);
+        emit_char('"');
         if (i < count - 1) {
-            printf(",");
+            emit_char(',');
         }
-        printf("\n");
-        free(escaped);
+        emit_char('\n');
     }
-    printf("    ]");
+    emit_string("    ]");
+}
+
+static void print_json(int env_count, int argc, char *argv[]) {
+    emit_string("{\n");
+
+    // Print environment variables.
+    print_string_array("env", environ, env_count);
+    emit_string(",\n");
+
+    // Print arguments.
+    print_string_array("argv", argv, argc);
+    emit_char('\n');
+
+    emit_string("}\n");
+}
+
+// ============================================================================
+// NUL-Delimited Output
+// ============================================================================
+
+static void print_nul_array(char **strings, int count) {
+    emit_unsigned((unsigned long long)count);
+    emit_char('\0');
+    for (int i = 0; i < count; i++) {
+        emit_string(strings[i]);
+        emit_char('\0');
+    }
+}
+
+// ============================================================================
+// Latency Probe
+// ============================================================================
+
+static int report_elapsed(const char *start_ns) {
+    // The timestamp comes from a benchmark script, so reject anything that is
+    // not a plain decimal rather than silently reporting a nonsense interval.
+    char *end = NULL;
+    errno = 0;
+    unsigned long long start = strtoull(start_ns, &end, 10);
+    if (errno != 0 || end == start_ns || *end != '\0') {
+        fprintf(stderr, "test-runscript: invalid TEST_RUNSCRIPT_START_NS: %s\n", start_ns);
+        return 1;
+    }
+
+    struct timespec now;
+    if (clock_gettime(CLOCK_REALTIME, &now) != 0) {
+        perror("test-runscript: clock_gettime");
+        return 1;
+    }
+    unsigned long long now_ns = (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+    if (now_ns < start) {
+        fprintf(stderr, "test-runscript: TEST_RUNSCRIPT_START_NS is in the future\n");
+        return 1;
+    }
+
+    emit_unsigned(now_ns - start);
+    emit_char('\n');
+    flush_output();
+    return 0;
 }
 
 int main(int argc, char *argv[]) {
+    // Read the timestamp first so the probe adds as little as possible to the interval.
+    const char *start_ns = getenv("TEST_RUNSCRIPT_START_NS");
+    if (start_ns != NULL) {
+        return report_elapsed(start_ns);
+    }
+
     // Count environment variables.
     int env_count = 0;
     for (char **env = environ; *env != NULL; env++) {
         env_count++;
     }
 
-    // Output JSON.
-    printf("{\n");
-    
-    // Print environment variables.
-    print_string_array("env", environ, env_count);
-    printf(",\n");
-    
-    // Print arguments.
-    print_string_array("argv", argv, argc);
-    printf("\n");
-    
-    printf("}\n");
+    const char *format = getenv("TEST_RUNSCRIPT_FORMAT");
+    if (format == NULL || strcmp(format, "json") == 0) {
+        print_json(env_count, argc, argv);
+    } else if (strcmp(format, "nul") == 0) {
+        print_nul_array(environ, env_count);
+        print_nul_array(argv, argc);
+    } else {
+        fprintf(stderr, "test-runscript: unknown TEST_RUNSCRIPT_FORMAT: %s\n", format);
+        fprintf(stderr, "  Hint: Valid formats are: json nul\n");
+        return 1;
+    }
 
+    flush_output();
     return 0;
 }